@@ -2,6 +2,7 @@
 
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/xml_oarchive.hpp>
+#include <dns/dns_name.hpp>
 #include <ostream>
 #include <span>
 
@@ -60,6 +61,7 @@ namespace DNS {
     struct Query {
         Name     Name = {};
         Question Question = {};
+        uint64_t NameHash = {};
     };
 
     struct ResourceRecord {
@@ -88,7 +90,9 @@ namespace DNS {
         return dest.bufferWrap;
     }
 
-    auto ParseName(const uint8_t* pData) noexcept -> std::string;
+    auto ParseName(std::span<const uint8_t> buffer, uint64_t& hash) -> std::string;
+
+    auto ParseName(std::span<const uint8_t> buffer) -> std::string;
 
     auto CreatePackageFromBuffer(std::span<const uint8_t> buffer) -> Package;
 
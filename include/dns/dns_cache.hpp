@@ -26,29 +26,83 @@
 #pragma once
 
 #include <dns/dns.hpp>
+#include <atomic>
 #include <condition_variable>
 #include <shared_mutex>
 
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
 class DNSCache {
 public:
-    auto Add(std::string const& name, DNS::Package const package) -> void;
+    DNSCache(size_t capacity, size_t shardCount);
+
+    //Packages are keyed by the case-insensitive question name, hashed once by the parser
+    auto Add(DNS::Query const& query, DNS::Package const package) -> void;
+
+    auto Get(DNS::Query const& query) const->std::optional<DNS::Package>;
+
+    //Version of the cached packages. Changes whenever TTLs are rewritten or packages expire.
+    //Evicted packages are still valid, so eviction leaves it as is
+    auto Epoch() const noexcept -> uint64_t { return m_Epoch.load(std::memory_order_acquire); }
 
-    auto Get(std::string const& name) const->std::optional<DNS::Package>;
+    //Maximum number of names, 0 is unlimited. Shrinking it evicts names down to the new budget
+    auto SetCapacity(size_t capacity) -> void;
 
     auto RemoveTimeoutPackages(uint32_t seconds) -> void;
 
     template<class Predicate>
     auto RemoveTimeoutPackagesWaitFor(uint32_t seconds, Predicate predicate) -> void {
+        {
+            std::unique_lock lock(m_MutexWakeUp);
+            m_WakeUp.wait_for(lock, std::chrono::seconds(seconds), predicate);
+        }
         RemoveTimeoutPackages(seconds);
-        std::unique_lock lock(m_MutexWakeUp);
-        m_WakeUp.wait_for(lock, std::chrono::seconds(seconds), predicate);
     }
 
 private:
-    using MapPackage = std::unordered_map<std::string, DNS::Package>;
+    using MapPackage = std::unordered_map<std::string, DNS::Package, DNS::NameHash, DNS::NameEqual>;
+
+    struct Shard {
+        alignas(CACHE_LINE_SIZE) mutable std::shared_mutex Mutex = {};
+        MapPackage Packages = {};
+    };
+
+    auto FindShard(uint64_t hash) const noexcept -> Shard const&;
+
+    auto FindShard(uint64_t hash) noexcept -> Shard&;
+
+    auto ShardCapacity(Shard const& shard, size_t capacity) const noexcept -> size_t;
 
-    mutable std::shared_mutex m_MutexCache = {};
-    MapPackage                m_PackageCache = {};
+    //Read by every worker on each query, so keep them away from the locks which are written on each query
+    alignas(CACHE_LINE_SIZE) std::atomic_uint64_t m_Epoch = {};
+    std::atomic_size_t        m_Capacity = {};
+    std::vector<Shard>        m_Shards;
     std::condition_variable   m_WakeUp;
     std::mutex                m_MutexWakeUp;
+};
+
+//Replicas are scanned linearly on every query, so they have to stay small
+constexpr std::size_t MAX_REPLICA_SIZE = 256;
+
+//Small per-thread read-through copy of the hottest entries of DNSCache.
+//Hits never touch the shared cache lines of DNSCache besides the read-mostly epoch
+class DNSCacheReplica {
+public:
+    DNSCacheReplica(DNSCache const& cache, size_t capacity);
+
+    auto Get(DNS::Query const& query) -> std::optional<DNS::Package>;
+
+private:
+    struct Entry {
+        uint64_t     Hash = {};
+        std::string  Name = {};
+        DNS::Package Package = {};
+        uint64_t     Hits = {};
+    };
+
+    DNSCache const&    m_Cache;
+    std::vector<Entry> m_Entries = {};
+    size_t             m_Capacity = {};
+    size_t             m_Replacements = {};
+    uint64_t           m_Epoch = {};
 };
\ No newline at end of file
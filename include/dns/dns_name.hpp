@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ *
+ * Copyright(c) 2021 Mikhail Gorobets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this softwareand associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright noticeand this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace DNS {
+
+    constexpr std::size_t MAX_NAME_SIZE = 255;
+
+    struct NameScan {
+        size_t   Size = {};
+        uint64_t Hash = {};
+    };
+
+    //Walk the labels of the wire name at the start of the buffer, lowercase ASCII and hash it in one pass.
+    //Return std::nullopt if a label length is invalid or the name does not end inside the buffer
+    auto ScanName(std::span<const uint8_t> buffer) noexcept -> std::optional<NameScan>;
+
+    //Size of the wire name at the start of the buffer, validated like ScanName but without hashing.
+    //For names which are never looked up, e.g. the owners of resource records
+    auto NameSize(std::span<const uint8_t> buffer) noexcept -> std::optional<size_t>;
+
+    //Case-insensitive hash of a wire name, equal to ScanName(name).Hash
+    auto HashName(std::string_view name) noexcept -> uint64_t;
+
+    //Case-insensitive comparison of wire names. The last byte may be a compression pointer and is compared exactly
+    auto EqualNames(std::string_view lhs, std::string_view rhs) noexcept -> bool;
+
+    //Name with a hash computed by ScanName, for lookups without hashing the name again
+    struct NameKey {
+        std::string_view Name = {};
+        uint64_t         Hash = {};
+    };
+
+    struct NameHash {
+        using is_transparent = void;
+
+        auto operator()(std::string_view name) const noexcept -> size_t { return static_cast<size_t>(HashName(name)); }
+
+        auto operator()(NameKey const& key) const noexcept -> size_t { return static_cast<size_t>(key.Hash); }
+    };
+
+    struct NameEqual {
+        using is_transparent = void;
+
+        auto operator()(std::string_view lhs, std::string_view rhs) const noexcept -> bool { return EqualNames(lhs, rhs); }
+
+        auto operator()(NameKey const& lhs, std::string_view rhs) const noexcept -> bool { return EqualNames(lhs.Name, rhs); }
+
+        auto operator()(std::string_view lhs, NameKey const& rhs) const noexcept -> bool { return EqualNames(lhs, rhs.Name); }
+    };
+}
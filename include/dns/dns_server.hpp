@@ -27,6 +27,8 @@
 #include <boost/asio.hpp>
 #include <dns/dns.hpp>
 #include <dns/dns_cache.hpp>
+#include <dns/dns_affinity.hpp>
+#include <dns/dns_settings.hpp>
 
 namespace NET {
     using SocketUDP = boost::asio::ip::udp::socket;
@@ -71,14 +73,35 @@ public:
 
 private:
     using PtrDNSCache = std::unique_ptr<DNSCache>;
+    using PtrDNSCacheReplica = std::unique_ptr<DNSCacheReplica>;
+    using PtrSettings = std::shared_ptr<const DNSSettings>;
     using PtrSocketUDP = std::unique_ptr<NET::SocketUDP>;
     using PtrSignalSet = std::unique_ptr<NET::SignalSet>;
-    using ThreadPool = boost::asio::thread_pool;
-
-    std::atomic_bool m_IsApplicationRun = {};
-    ThreadPool       m_Dispather = {};
-    PtrDNSCache      m_Cache = {};
-    NET::IOContext   m_Service = {};
-    PtrSignalSet     m_SignalSet = {};
-    PtrSocketUDP     m_Socket = {};
-};
+    using PtrThreadPool = std::unique_ptr<boost::asio::thread_pool>;
+
+    auto Settings() const -> PtrSettings;
+
+    auto ReloadSettings() -> void;
+
+    auto StoreTimeouts(DNSSettings const& settings) -> void;
+
+    auto WaitSignal() -> void;
+
+    auto QueryUpstream(DNSSettings const& settings, std::span<const uint8_t> query) -> std::vector<uint8_t>;
+
+    std::atomic_bool                m_IsApplicationRun = {};
+    std::vector<std::string>        m_Arguments = {};
+    mutable std::shared_mutex       m_MutexSettings = {};
+    PtrSettings                     m_Settings = {};
+    std::atomic_uint32_t            m_ReceiveTimeout = {};
+    std::atomic_uint32_t            m_UpstreamTimeout = {};
+    std::atomic_uint32_t            m_SweepInterval = {};
+    std::atomic_size_t              m_UpstreamIndex = {};
+    size_t                          m_ThreadCount = {};
+    PtrThreadPool                   m_Dispather = {};
+    PtrDNSCache                     m_Cache = {};
+    std::vector<PtrDNSCacheReplica> m_Replicas = {};
+    NET::IOContext                  m_Service = {};
+    PtrSignalSet                    m_SignalSet = {};
+    std::vector<PtrSocketUDP>       m_Sockets = {};
+};
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright(c) 2021 Mikhail Gorobets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this softwareand associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright noticeand this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <boost/asio/ip/udp.hpp>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct DNSSettings {
+    using Address = boost::asio::ip::address;
+    using Endpoint = boost::asio::ip::udp::endpoint;
+
+    //"::" accepts both IPv4 and IPv6 queries
+    std::vector<Address>  ListenAddresses = { boost::asio::ip::address_v6::any() };
+    uint16_t              Port = 57;
+    size_t                ReactorCount = 1;
+    size_t                WorkerCount = std::max<size_t>(2 * std::thread::hardware_concurrency(), 4);
+    std::vector<uint32_t> Cpus = {};
+    size_t                CacheCapacity = 0;
+    size_t                CacheShards = 16;
+    size_t                HotCacheSize = 0;
+    uint32_t              ReceiveTimeout = 200;
+    uint32_t              UpstreamTimeout = 2000;
+    uint32_t              SweepInterval = 60;
+    std::vector<Endpoint> Upstreams = { Endpoint(boost::asio::ip::make_address_v4("5.3.3.3"), 53) };
+};
+
+//Build settings from defaults, then the file passed with --config, then the rest of the command line
+auto LoadSettings(std::vector<std::string> const& arguments) -> DNSSettings;
+
+//Copy the settings which are safe to change at runtime. Return false if any other setting differs.
+//Throw if the loaded settings do not fit the running ones
+auto ApplyReloadableSettings(DNSSettings& current, DNSSettings const& loaded) -> bool;
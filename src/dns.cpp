@@ -25,42 +25,53 @@
 #include <dns/dns.hpp>
 #include <fmt/ostream.h>
 #include <fmt/printf.h>
+#include <stdexcept>
 
 namespace DNS {
 
 
-    auto ParseName(const uint8_t* pData) noexcept -> std::string {
-        if (pData[0] == 0xC0) //Comression name
-            return std::string(pData, pData + 2);
-        if (pData[0] == 0x00) //Root name
-            return std::string(pData, pData + 1);
-        size_t size = std::strlen(reinterpret_cast<const char* const>(pData) + 1);
-        return std::string(pData, pData + size + 2);
+    auto ParseName(std::span<const uint8_t> buffer, uint64_t& hash) -> std::string {
+        auto scan = DNS::ScanName(buffer);
+        if (!scan.has_value())
+            throw std::invalid_argument("Malformed DNS name");
+        hash = scan->Hash;
+        return std::string(buffer.data(), buffer.data() + scan->Size);
+    }
+
+    auto ParseName(std::span<const uint8_t> buffer) -> std::string {
+        auto size = DNS::NameSize(buffer);
+        if (!size.has_value())
+            throw std::invalid_argument("Malformed DNS name");
+        return std::string(buffer.data(), buffer.data() + size.value());
     }
 
     auto CreatePackageFromBuffer(std::span<const uint8_t> buffer) -> Package {
         size_t offset = 0;
         Package package = {};
-        std::memcpy(&package.Header, buffer.data(), sizeof(DNS::Header));
-        offset += sizeof(DNS::Header);
+
+        auto Load = [&](void* pDestination, size_t size) {
+            if (size > buffer.size() - offset)
+                throw std::out_of_range("Truncated DNS package");
+            std::memcpy(pDestination, buffer.data() + offset, size);
+            offset += size;
+        };
+
+        Load(&package.Header, sizeof(DNS::Header));
         auto LoadQuery = [&](std::vector<DNS::Query>& quries) {
             DNS::Query query = {};
-            query.Name = DNS::ParseName(buffer.data() + offset);
+            query.Name = DNS::ParseName(buffer.subspan(offset), query.NameHash);
             offset += query.Name.size();
-            std::memcpy(&query.Question, buffer.data() + offset, sizeof(DNS::Question));
-            offset += sizeof(DNS::Question);
+            Load(&query.Question, sizeof(DNS::Question));
             quries.push_back(std::move(query));
         };
 
         auto LoadResource = [&](std::vector<DNS::ResourceRecord>& resources) {
             DNS::ResourceRecord resource = {};
-            resource.Name = DNS::ParseName(buffer.data() + offset);
+            resource.Name = DNS::ParseName(buffer.subspan(offset));
             offset += resource.Name.size();
-            std::memcpy(&resource.Answer, buffer.data() + offset, sizeof(DNS::Answer));
-            offset += sizeof(DNS::Answer);
+            Load(&resource.Answer, sizeof(DNS::Answer));
             resource.Data.resize(DNS::SwapEndian<uint16_t>(resource.Answer.DataLenght));
-            std::memcpy(const_cast<char*>(resource.Data.data()), buffer.data() + offset, DNS::SwapEndian<uint16_t>(resource.Answer.DataLenght));
-            offset += DNS::SwapEndian<uint16_t>(resource.Answer.DataLenght);
+            Load(resource.Data.data(), resource.Data.size());
             resources.push_back(std::move(resource));
         };
 
@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ *
+ * Copyright(c) 2021 Mikhail Gorobets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this softwareand associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright noticeand this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <dns/dns_affinity.hpp>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Affinity {
+
+#if defined(__linux__)
+    constexpr uint32_t MAX_CPU_COUNT = CPU_SETSIZE;
+#else
+    //Windows limit of logical processors over all processor groups
+    constexpr uint32_t MAX_CPU_COUNT = 2048;
+#endif
+
+    static auto ParseCpu(std::string_view value, std::string const& range) -> uint32_t {
+        //Allow spaces around list items and range bounds, e.g. "0-3, 8"
+        size_t const first = value.find_first_not_of(" \t");
+        value = first == std::string_view::npos ? std::string_view{} : value.substr(first, value.find_last_not_of(" \t") - first + 1);
+
+        uint32_t cpu = {};
+        auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), cpu);
+        if (error != std::errc{} || end != value.data() + value.size() || cpu >= MAX_CPU_COUNT)
+            throw std::invalid_argument("Invalid CPU range: " + range);
+        return cpu;
+    }
+
+    auto ParseCpuList(std::string const& list) -> std::vector<uint32_t> {
+        std::vector<uint32_t> cpus;
+        size_t offset = 0;
+        while (offset < list.size()) {
+            size_t end = list.find(',', offset);
+            if (end == std::string::npos)
+                end = list.size();
+
+            std::string const range = list.substr(offset, end - offset);
+            size_t const dash = range.find('-');
+            uint32_t const first = ParseCpu(std::string_view(range).substr(0, dash), range);
+            uint32_t const last = dash == std::string::npos ? first : ParseCpu(std::string_view(range).substr(dash + 1), range);
+            if (last < first)
+                throw std::invalid_argument("Invalid CPU range: " + range);
+
+            //Both bounds are below MAX_CPU_COUNT, so the counter cannot wrap around
+            for (uint32_t cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+            offset = end + 1;
+        }
+        return cpus;
+    }
+
+    auto PinCurrentThread(uint32_t cpu) noexcept -> bool {
+#ifdef _WIN32
+        //Groups may hold fewer than 64 CPUs, e.g. two groups of 48 on a two-socket box,
+        //so walk them to turn the flat index into a group and a bit inside it
+        WORD const groupCount = GetActiveProcessorGroupCount();
+        for (WORD group = 0; group < groupCount; group++) {
+            DWORD const count = GetActiveProcessorCount(group);
+            if (cpu < count) {
+                GROUP_AFFINITY affinity = {};
+                affinity.Group = group;
+                affinity.Mask = KAFFINITY(1) << cpu;
+                return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+            }
+            cpu -= count;
+        }
+        return false;
+#elif defined(__linux__)
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+        return false;
+#endif
+    }
+}
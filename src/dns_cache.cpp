@@ -24,37 +24,148 @@
 
 
 #include <dns/dns_cache.hpp>
+#include <algorithm>
 
-auto DNSCache::Add(std::string const& name, DNS::Package const package) -> void {
-    std::unique_lock lock(m_MutexCache);
-    m_PackageCache.emplace(name, package);
+//More shards than the budget would leave some of them with no room at all
+DNSCache::DNSCache(size_t capacity, size_t shardCount)
+    : m_Capacity(capacity)
+    , m_Shards(std::max<size_t>(capacity != 0 ? std::min(shardCount, capacity) : shardCount, 1)) {
 }
 
-auto DNSCache::Get(std::string const& name) const -> std::optional<DNS::Package> {
-    std::shared_lock lock(m_MutexCache);
-    if (auto iter = m_PackageCache.find(name); iter != m_PackageCache.end())
+//The high half of the hash picks the shard, the low half is left to the buckets inside it
+auto DNSCache::FindShard(uint64_t hash) const noexcept -> Shard const& {
+    return m_Shards[(hash >> 32) % m_Shards.size()];
+}
+
+auto DNSCache::FindShard(uint64_t hash) noexcept -> Shard& {
+    return m_Shards[(hash >> 32) % m_Shards.size()];
+}
+
+//The budget is split between shards so that the total never exceeds it, and the check never touches other shards
+auto DNSCache::ShardCapacity(Shard const& shard, size_t capacity) const noexcept -> size_t {
+    size_t const index = static_cast<size_t>(&shard - m_Shards.data());
+    return capacity / m_Shards.size() + (index < capacity % m_Shards.size() ? 1 : 0);
+}
+
+//Evict the first package found from the bucket of the given hash onwards. This is random eviction,
+//so lookups stay read-only and need no recency bookkeeping
+template<typename Map>
+static auto EvictPackage(Map& packages, uint64_t hash) -> void {
+    size_t const count = packages.bucket_count();
+    for (size_t index = 0; index < count; index++) {
+        size_t const bucket = (hash + index) % count;
+        if (packages.bucket_size(bucket) != 0) {
+            packages.erase(packages.find(packages.begin(bucket)->first));
+            return;
+        }
+    }
+}
+
+auto DNSCache::SetCapacity(size_t capacity) -> void {
+    m_Capacity.store(capacity, std::memory_order_relaxed);
+    if (capacity == 0)
+        return;
+
+    for (auto& shard : m_Shards) {
+        std::unique_lock lock(shard.Mutex);
+        size_t const budget = ShardCapacity(shard, capacity);
+        if (shard.Packages.size() <= budget)
+            continue;
+        while (shard.Packages.size() > budget)
+            EvictPackage(shard.Packages, shard.Packages.size());
+        //Release the buckets of the evicted packages, or a large budget keeps its memory after shrinking
+        shard.Packages.rehash(0);
+    }
+}
+
+auto DNSCache::Add(DNS::Query const& query, DNS::Package const package) -> void {
+    auto& shard = FindShard(query.NameHash);
+    size_t capacity = m_Capacity.load(std::memory_order_relaxed);
+    std::unique_lock lock(shard.Mutex);
+    if (capacity != 0) {
+        size_t const budget = ShardCapacity(shard, capacity);
+        if (budget == 0 || shard.Packages.contains(DNS::NameKey{ query.Name, query.NameHash }))
+            return;
+        while (shard.Packages.size() >= budget)
+            EvictPackage(shard.Packages, query.NameHash);
+    }
+    shard.Packages.emplace(query.Name, package);
+}
+
+auto DNSCache::Get(DNS::Query const& query) const -> std::optional<DNS::Package> {
+    auto const& shard = FindShard(query.NameHash);
+    std::shared_lock lock(shard.Mutex);
+    if (auto iter = shard.Packages.find(DNS::NameKey{ query.Name, query.NameHash }); iter != shard.Packages.end())
         return iter->second;
     return std::nullopt;
 }
 
 auto DNSCache::RemoveTimeoutPackages(uint32_t seconds) -> void {
-    std::unique_lock lock(m_MutexCache);
     auto Predicate = [seconds](DNS::ResourceRecord& record) -> bool {
-        if (!std::in_range<uint32_t>(DNS::SwapEndian(record.Answer.TTL) - seconds))
+        uint32_t const ttl = DNS::SwapEndian(record.Answer.TTL);
+        if (ttl <= seconds)
             return true;
-        record.Answer.TTL = DNS::SwapEndian((DNS::SwapEndian(record.Answer.TTL) - seconds));
+        record.Answer.TTL = DNS::SwapEndian(ttl - seconds);
         return false;
     };
 
-    for (auto& [name, package] : m_PackageCache) {
-        std::erase_if(package.Answers, Predicate);
-        std::erase_if(package.Authoritys, Predicate);
+    for (auto& shard : m_Shards) {
+        std::unique_lock lock(shard.Mutex);
+        for (auto& [name, package] : shard.Packages) {
+            std::erase_if(package.Answers, Predicate);
+            std::erase_if(package.Authoritys, Predicate);
+        }
+
+        std::erase_if(shard.Packages, [](auto const& item) -> bool {
+            auto const& [name, package] = item;
+            if (package.Answers.empty() && package.Authoritys.empty())
+                return true;
+            return false;
+        });
     }
 
-    std::erase_if(m_PackageCache, [](auto const& item) -> bool {
-        auto const& [name, package] = item;
-        if (package.Answers.empty() && package.Authoritys.empty())
-            return true;
-        return false;
-    });
+    //TTLs were rewritten, so every replica has to drop its copies
+    m_Epoch.fetch_add(1, std::memory_order_release);
+}
+
+DNSCacheReplica::DNSCacheReplica(DNSCache const& cache, size_t capacity)
+    : m_Cache(cache)
+    , m_Capacity(capacity)
+    , m_Epoch(cache.Epoch()) {
+    m_Entries.reserve(capacity);
+}
+
+auto DNSCacheReplica::Get(DNS::Query const& query) -> std::optional<DNS::Package> {
+    //Load the epoch before reading the shared cache: a package fetched after a concurrent
+    //sweep is then stored under the older epoch and dropped on the next lookup
+    if (uint64_t epoch = m_Cache.Epoch(); epoch != m_Epoch) {
+        m_Entries.clear();
+        m_Epoch = epoch;
+    }
+
+    for (auto& entry : m_Entries) {
+        if (entry.Hash == query.NameHash && DNS::EqualNames(entry.Name, query.Name)) {
+            entry.Hits++;
+            return entry.Package;
+        }
+    }
+
+    auto package = m_Cache.Get(query);
+    if (!package.has_value() || m_Capacity == 0)
+        return package;
+
+    //Replace the least used entry, so the replica converges to the hottest names of this thread.
+    //All hits are halved once per capacity replacements, so names which were hot once do not keep their place forever
+    if (m_Entries.size() < m_Capacity) {
+        m_Entries.push_back({query.NameHash, query.Name, package.value(), 1});
+    } else {
+        if (++m_Replacements >= m_Capacity) {
+            for (auto& entry : m_Entries)
+                entry.Hits /= 2;
+            m_Replacements = 0;
+        }
+        auto iter = std::min_element(m_Entries.begin(), m_Entries.end(), [](auto const& lhs, auto const& rhs) { return lhs.Hits < rhs.Hits; });
+        *iter = {query.NameHash, query.Name, package.value(), 1};
+    }
+    return package;
 }
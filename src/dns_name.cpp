@@ -0,0 +1,211 @@
+/*
+ * MIT License
+ *
+ * Copyright(c) 2021 Mikhail Gorobets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this softwareand associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright noticeand this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <dns/dns_name.hpp>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DNS_NAME_SSE2
+#endif
+
+#if defined(DNS_NAME_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace DNS {
+
+    using LowercaseFunction = void(*)(uint8_t* pBlock) noexcept;
+
+#if defined(DNS_NAME_AVX2)
+    //Compiled with AVX2 in dns_name_avx2.cpp, called only after IsAVX2Supported
+    auto LowercaseBlockAVX2(uint8_t* pBlock) noexcept -> void;
+#endif
+
+    constexpr size_t BLOCK_SIZE = 16;
+    constexpr size_t BLOCK_SIZE_AVX2 = 32;
+
+    constexpr uint64_t HASH_SEED = 0x9E3779B97F4A7C15;
+    constexpr uint64_t HASH_PRIME = 0xFF51AFD7ED558CCD;
+
+    static auto LowercaseBlock(uint8_t* pBlock) noexcept -> void {
+#if defined(DNS_NAME_SSE2)
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlock));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(data, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(data, _mm_set1_epi8('Z' + 1)));
+        data = _mm_or_si128(data, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pBlock), data);
+#else
+        for (size_t index = 0; index < BLOCK_SIZE; index++)
+            if (pBlock[index] >= 'A' && pBlock[index] <= 'Z')
+                pBlock[index] |= 0x20;
+#endif
+    }
+
+    //Mix up to BlockSize lowercased bytes into the hash. Words are taken at the same offsets for every block
+    //size, and a partial word is zero padded, so all instruction sets give the same hash.
+    //The last byte of a name is either the root label or the low byte of a compression pointer, it is never folded
+    template<size_t BlockSize, LowercaseFunction Lowercase>
+    static auto HashBlock(uint64_t hash, const uint8_t* pData, size_t count, bool isLast) noexcept -> uint64_t {
+        alignas(BlockSize) uint8_t block[BlockSize] = {};
+        std::memcpy(block, pData, count);
+        Lowercase(block);
+        if (isLast)
+            block[count - 1] = pData[count - 1];
+
+        for (size_t offset = 0; offset < count; offset += sizeof(uint64_t)) {
+            uint64_t word = {};
+            std::memcpy(&word, block + offset, sizeof(uint64_t));
+            hash = (hash ^ word) * HASH_PRIME;
+            hash ^= hash >> 32;
+        }
+        return hash;
+    }
+
+    static auto FinalizeHash(uint64_t hash, size_t size) noexcept -> uint64_t {
+        hash ^= size;
+        hash ^= hash >> 33;
+        hash *= HASH_PRIME;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    template<size_t BlockSize, LowercaseFunction Lowercase>
+    static auto ScanNameBlocks(std::span<const uint8_t> buffer) noexcept -> std::optional<NameScan> {
+        size_t const limit = std::min(buffer.size(), MAX_NAME_SIZE);
+        uint64_t hash = HASH_SEED;
+        size_t next = 0;
+        size_t size = 0;
+
+        for (size_t offset = 0;; offset += BlockSize) {
+            //Follow the label lengths which fall into this block, the bytes in between are never inspected
+            while (size == 0 && next < offset + BlockSize) {
+                if (next >= limit)
+                    return std::nullopt;
+                uint8_t length = buffer[next];
+                if (length == 0x00)
+                    size = next + 1;
+                else if ((length & 0xC0) == 0xC0) //Comression pointer ends the name
+                    size = next + 2;
+                else if ((length & 0xC0) != 0x00)
+                    return std::nullopt;
+                else
+                    next += length + 1;
+            }
+
+            //A label must not run past the buffer and a compression pointer must be complete
+            if (size == 0 ? next > limit : size > buffer.size())
+                return std::nullopt;
+
+            size_t count = size == 0 ? BlockSize : std::min(size - offset, BlockSize);
+            bool const isLast = size != 0 && offset + count == size;
+            hash = HashBlock<BlockSize, Lowercase>(hash, buffer.data() + offset, count, isLast);
+            if (isLast)
+                return NameScan{ size, FinalizeHash(hash, size) };
+        }
+    }
+
+    template<size_t BlockSize, LowercaseFunction Lowercase>
+    static auto HashNameBlocks(std::string_view name) noexcept -> uint64_t {
+        auto const pData = reinterpret_cast<const uint8_t*>(name.data());
+        uint64_t hash = HASH_SEED;
+        for (size_t offset = 0; offset < name.size(); offset += BlockSize) {
+            size_t const count = std::min(name.size() - offset, BlockSize);
+            hash = HashBlock<BlockSize, Lowercase>(hash, pData + offset, count, offset + count == name.size());
+        }
+        return FinalizeHash(hash, name.size());
+    }
+
+#if defined(DNS_NAME_AVX2)
+    //The CPU has to support AVX2 and the OS has to save the YMM registers
+    static auto IsAVX2Supported() noexcept -> bool {
+#if defined(_MSC_VER)
+        int32_t info[4] = {};
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool const isOSXSave = (info[2] & (1 << 27)) != 0;
+        bool const isAVX = (info[2] & (1 << 28)) != 0;
+        if (!isOSXSave || !isAVX || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    struct NameKernel {
+        std::optional<NameScan>(*Scan)(std::span<const uint8_t> buffer) noexcept;
+        uint64_t(*Hash)(std::string_view name) noexcept;
+    };
+
+    static auto SelectNameKernel() noexcept -> NameKernel {
+#if defined(DNS_NAME_AVX2)
+        if (IsAVX2Supported())
+            return { ScanNameBlocks<BLOCK_SIZE_AVX2, LowercaseBlockAVX2>, HashNameBlocks<BLOCK_SIZE_AVX2, LowercaseBlockAVX2> };
+#endif
+        return { ScanNameBlocks<BLOCK_SIZE, LowercaseBlock>, HashNameBlocks<BLOCK_SIZE, LowercaseBlock> };
+    }
+
+    static NameKernel const s_NameKernel = SelectNameKernel();
+
+    auto ScanName(std::span<const uint8_t> buffer) noexcept -> std::optional<NameScan> {
+        return s_NameKernel.Scan(buffer);
+    }
+
+    auto NameSize(std::span<const uint8_t> buffer) noexcept -> std::optional<size_t> {
+        size_t const limit = std::min(buffer.size(), MAX_NAME_SIZE);
+        for (size_t next = 0; next < limit;) {
+            uint8_t length = buffer[next];
+            if (length == 0x00)
+                return next + 1;
+            if ((length & 0xC0) == 0xC0) //Compression pointer ends the name
+                return next + 2 <= buffer.size() ? std::optional<size_t>(next + 2) : std::nullopt;
+            if ((length & 0xC0) != 0x00)
+                return std::nullopt;
+            next += length + 1;
+        }
+        return std::nullopt;
+    }
+
+    auto HashName(std::string_view name) noexcept -> uint64_t {
+        return s_NameKernel.Hash(name);
+    }
+
+    //Like HashBlock, compare the last byte exactly: "\xC0\x41" and "\xC0\x61" point to different names
+    auto EqualNames(std::string_view lhs, std::string_view rhs) noexcept -> bool {
+        if (lhs.size() != rhs.size())
+            return false;
+        if (lhs.empty())
+            return true;
+        auto ToLower = [](char c) -> char { return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c; };
+        return std::equal(lhs.begin(), lhs.end() - 1, rhs.begin(), [&](char a, char b) { return ToLower(a) == ToLower(b); }) && lhs.back() == rhs.back();
+    }
+}
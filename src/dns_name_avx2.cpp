@@ -0,0 +1,39 @@
+/*
+ * MIT License
+ *
+ * Copyright(c) 2021 Mikhail Gorobets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this softwareand associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright noticeand this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+//Built with AVX2 enabled, so it must not include anything that other files share:
+//an inline function compiled here could be picked by the linker and run on any CPU
+#include <immintrin.h>
+#include <cstdint>
+
+namespace DNS {
+
+    auto LowercaseBlockAVX2(uint8_t* pBlock) noexcept -> void {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(data, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), data));
+        data = _mm256_or_si256(data, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pBlock), data);
+    }
+}
@@ -25,84 +25,257 @@
 
 #include <dns/dns_server.hpp>
 #include <fmt/printf.h>
+#include <algorithm>
+#include <latch>
+#include <limits>
 
- DNSServer::DNSServer(int argc, char* argv[]) {
-    m_Cache = std::make_unique<DNSCache>();
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+//Hot entries replica of the pool thread which executes the current task
+static thread_local DNSCacheReplica* t_Replica = nullptr;
+
+//Wait until the socket is readable or the timeout expires. Sockets are non-blocking,
+//because asio ignores SO_RCVTIMEO and blocking receives would never time out
+static auto WaitReadable(NET::SocketUDP& socket, std::chrono::milliseconds timeout) -> bool {
+    //A negative timeout would wait forever
+    auto const milliseconds = static_cast<int32_t>(std::clamp<int64_t>(timeout.count(), 0, std::numeric_limits<int32_t>::max()));
+#ifdef _WIN32
+    WSAPOLLFD descriptor = { socket.native_handle(), POLLRDNORM, 0 };
+    return WSAPoll(&descriptor, 1, milliseconds) > 0;
+#else
+    pollfd descriptor = { socket.native_handle(), POLLIN, 0 };
+    return ::poll(&descriptor, 1, milliseconds) > 0;
+#endif
+}
+
+ DNSServer::DNSServer(int argc, char* argv[]) : m_Arguments(argv, argv + argc) {
+    try {
+        m_Settings = std::make_shared<const DNSSettings>(LoadSettings(m_Arguments));
+    } catch (std::exception const& error) {
+        fmt::print("Error: {} \n", error.what());
+        fmt::print("Use --help to list the options \n");
+        std::exit(EXIT_FAILURE);
+    }
+    auto const& settings = *m_Settings;
+    StoreTimeouts(settings);
+
+    m_Cache = std::make_unique<DNSCache>(settings.CacheCapacity, settings.CacheShards);
     m_SignalSet = std::make_unique<NET::SignalSet>(m_Service, SIGINT, SIGTERM);
-    m_Socket = std::make_unique<NET::SocketUDP>(m_Service, NET::UDPoint(NET::UDP::v4(), 57));
-    m_Socket->set_option(boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_RCVTIMEO>{ 200 });
+#ifdef SIGHUP
+    m_SignalSet->add(SIGHUP);
+#endif
+
+    //"::" accepts IPv4 queries too as IPv4-mapped addresses, unless IPv4 addresses are listed
+    //explicitly. Both sockets would claim the same IPv4 port otherwise
+    bool const isDualStack = std::none_of(settings.ListenAddresses.begin(), settings.ListenAddresses.end(), [](auto const& address) { return address.is_v4(); });
+
+    for (auto const& address : settings.ListenAddresses) {
+        NET::UDPoint point(address, settings.Port);
+        try {
+            auto socket = std::make_unique<NET::SocketUDP>(m_Service, point.protocol());
+            if (address.is_v6() && address.is_unspecified())
+                socket->set_option(boost::asio::ip::v6_only(!isDualStack));
+            socket->bind(point);
+            socket->non_blocking(true);
 
 #ifdef _WIN32
-    struct IOControlCommand {
-        uint32_t value = {};
-        auto name() -> int32_t { return SIO_UDP_CONNRESET; }
-        auto data() -> void* { return &value; }
-    };
-    IOControlCommand connectionReset = {};
-    m_Socket->io_control(connectionReset);
+            struct IOControlCommand {
+                uint32_t value = {};
+                auto name() -> int32_t { return SIO_UDP_CONNRESET; }
+                auto data() -> void* { return &value; }
+            };
+            IOControlCommand connectionReset = {};
+            socket->io_control(connectionReset);
 #endif
+            m_Sockets.push_back(std::move(socket));
+        } catch (std::exception const& error) {
+            fmt::print("Error: Failed to listen on [{}]:{}: {} \n", address.to_string(), settings.Port, error.what());
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    //Workers, reactors of every socket, the TTL sweeper and the signal handler
+    m_ThreadCount = settings.WorkerCount + settings.ReactorCount * m_Sockets.size() + 2;
+    m_Dispather = std::make_unique<boost::asio::thread_pool>(m_ThreadCount);
+}
+
+auto DNSServer::Settings() const -> PtrSettings {
+    std::shared_lock lock(m_MutexSettings);
+    return m_Settings;
+}
+
+//Reactors wake up on every receive timeout, so they read plain atomics instead of locking the settings
+auto DNSServer::StoreTimeouts(DNSSettings const& settings) -> void {
+    m_ReceiveTimeout.store(settings.ReceiveTimeout, std::memory_order_relaxed);
+    m_UpstreamTimeout.store(settings.UpstreamTimeout, std::memory_order_relaxed);
+    m_SweepInterval.store(settings.SweepInterval, std::memory_order_relaxed);
+}
+
+auto DNSServer::ReloadSettings() -> void {
+    try {
+        DNSSettings settings = *Settings();
+        if (!ApplyReloadableSettings(settings, LoadSettings(m_Arguments)))
+            fmt::print("DNS Server: Listen addresses, port, thread counts, CPU affinity, cache shards and replicas change after restart \n");
+
+        m_Cache->SetCapacity(settings.CacheCapacity);
+        StoreTimeouts(settings);
+
+        //Queries in flight keep the settings they started with
+        std::unique_lock lock(m_MutexSettings);
+        m_Settings = std::make_shared<const DNSSettings>(std::move(settings));
+        fmt::print("DNS Server: Settings reloaded \n");
+    } catch (std::exception const& error) {
+        fmt::print("DNS Server: Failed to reload settings: {} \n", error.what());
+    }
+}
+
+auto DNSServer::WaitSignal() -> void {
+    m_SignalSet->async_wait([this](auto const& error, int32_t signal) {
+        if (error)
+            return;
+#ifdef SIGHUP
+        if (signal == SIGHUP) {
+            ReloadSettings();
+            WaitSignal();
+            return;
+        }
+#endif
+        m_IsApplicationRun.store(false);
+        m_Dispather->stop();
+        fmt::print("DNS Server: Shutdown \n");
+    });
+}
+
+auto DNSServer::QueryUpstream(DNSSettings const& settings, std::span<const uint8_t> query) -> std::vector<uint8_t> {
+    //Start from the next upstream on each query and fall back to the others on failure
+    size_t first = m_UpstreamIndex.fetch_add(1, std::memory_order_relaxed);
+    for (size_t index = 0; index < settings.Upstreams.size(); index++) {
+        auto const& upstream = settings.Upstreams[(first + index) % settings.Upstreams.size()];
+
+        NET::Error result;
+        NET::SocketUDP socket = {m_Service, upstream.protocol()};
+        socket.non_blocking(true);
+        socket.send_to(NET::Buffer(query.data(), query.size()), upstream, {}, result);
+
+        auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_UpstreamTimeout.load(std::memory_order_relaxed));
+        std::vector<uint8_t> answer(DNS::PACKAGE_SIZE);
+        while (!result) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                result = boost::asio::error::timed_out;
+                break;
+            }
+            if (!WaitReadable(socket, remaining))
+                continue;
+
+            size_t size = socket.receive(NET::Buffer(answer), {}, result);
+            if (!result) {
+                answer.resize(size);
+                return answer;
+            }
+            if (result == boost::asio::error::would_block)
+                result = {};
+        }
+        fmt::print("DNS Server: Upstream {}:{} failed: {} \n", upstream.address().to_string(), upstream.port(), result.message());
+    }
+    return {};
 }
 
 auto DNSServer::Run() -> void {
+    auto const settings = Settings();
+
     fmt::print("DNS Server: Run \n");
-    fmt::print("DNS Server: IP: {}, Port: {} \n", m_Socket->local_endpoint().address().to_string(), m_Socket->local_endpoint().port());
+    for (auto const& socket : m_Sockets)
+        fmt::print("DNS Server: IP: {}, Port: {} \n", socket->local_endpoint().address().to_string(), socket->local_endpoint().port());
 
     m_IsApplicationRun = true;
 
+    //Every pool thread takes exactly one of these tasks, because each of them blocks until all threads arrive.
+    //A thread pins itself first and then allocates its replica, so the memory is first touched on its NUMA node
+    std::latch pinned(m_ThreadCount);
+    m_Replicas.resize(m_ThreadCount);
+    for (size_t index = 0; index < m_ThreadCount; index++) {
+        NET::Post(*m_Dispather, [this, index, &pinned, &settings]() {
+            if (!settings->Cpus.empty()) {
+                uint32_t cpu = settings->Cpus[index % settings->Cpus.size()];
+                if (!Affinity::PinCurrentThread(cpu))
+                    fmt::print("DNS Server: Failed to pin thread {} to CPU {} \n", index, cpu);
+            }
+            if (settings->HotCacheSize > 0) {
+                m_Replicas[index] = std::make_unique<DNSCacheReplica>(*m_Cache, settings->HotCacheSize);
+                t_Replica = m_Replicas[index].get();
+            }
+            pinned.arrive_and_wait();
+        });
+    }
+
     //Run a thread which remove DNS packet with timeout TTL
-    NET::Post(m_Dispather, [this]() {
+    NET::Post(*m_Dispather, [this]() {
         while (m_IsApplicationRun.load())
-            m_Cache->RemoveTimeoutPackagesWaitFor(60, [this]()-> bool { return !m_IsApplicationRun; });
+            m_Cache->RemoveTimeoutPackagesWaitFor(m_SweepInterval.load(std::memory_order_relaxed), [this]()-> bool { return !m_IsApplicationRun; });
     });
 
     //Run a thread which to process signals
-    NET::Post(m_Dispather, [this]() {
-        m_SignalSet->async_wait([&](auto const& error, int32_t signal) {
-            m_IsApplicationRun.store(false);
-            m_Dispather.stop();
-            fmt::print("DNS Server: Shutdown \n");
-        });
+    NET::Post(*m_Dispather, [this]() {
+        WaitSignal();
         m_Service.run();
     });
 
-    //Run a thread which accept DNS questions
-    NET::Post(m_Dispather, ([this]() {
-        while (m_IsApplicationRun.load()) {
-
-            NET::UDPoint point;
-            std::vector<uint8_t> buffer(DNS::PACKAGE_SIZE);
-
-            NET::Error result;
-            m_Socket->receive_from(NET::Buffer(buffer), point, {}, result);
-            switch (result.value()) {
-                case NET::ErrorType{}:
-                    break;
-                case NET::ErrorType::timed_out:
-                    continue;
-                default:
-                    fmt::print("Error: {} \n", result.message());
-                    continue;
-            }
+    //Run threads which accept DNS questions
+    for (auto const& socket : m_Sockets) {
+        for (size_t index = 0; index < settings->ReactorCount; index++) {
+            NET::Post(*m_Dispather, ([this, socket = socket.get()]() {
+                while (m_IsApplicationRun.load()) {
+                    if (!WaitReadable(*socket, std::chrono::milliseconds(m_ReceiveTimeout.load(std::memory_order_relaxed))))
+                        continue;
+
+                    //The buffer is first touched on the node of this reactor, but any pool thread may process it
+                    NET::UDPoint point;
+                    std::vector<uint8_t> buffer(DNS::PACKAGE_SIZE);
+
+                    NET::Error result;
+                    size_t size = socket->receive_from(NET::Buffer(buffer), point, {}, result);
+                    switch (result.value()) {
+                        case NET::ErrorType{}:
+                            break;
+                        case NET::ErrorType::would_block: //Another reactor took the datagram
+                            continue;
+                        default:
+                            fmt::print("Error: {} \n", result.message());
+                            continue;
+                    }
+                    buffer.resize(size);
+
+                    //Run a thread which to pricess a DNS question
+                    NET::Post(*m_Dispather, [this, socket, point = std::move(point), buffer = std::move(buffer)]() mutable {
+                        try {
+                            DNS::Package packet = DNS::CreatePackageFromBuffer(buffer);
+                            auto const& query = packet.Questions.at(0);
+                            auto cacheValue = t_Replica != nullptr ? t_Replica->Get(query) : m_Cache->Get(query);
+
+                            if (cacheValue.has_value()) {
+                                DNS::Package packetCached = cacheValue.value();
+                                packetCached.Header.ID = packet.Header.ID;
+                                //Names match case-insensitively, echo the question with the case of this client
+                                packetCached.Questions.at(0).Name = query.Name;
+                                socket->send_to(NET::Buffer(DNS::CreateBufferFromPackage(packetCached)), point);
 
-            //Run a thread which to pricess a DNS question
-            NET::Post(m_Dispather, [this, point = std::move(point), buffer = std::move(buffer)]() mutable {
-                DNS::Package packet = DNS::CreatePackageFromBuffer(buffer);
-                auto cacheValue = m_Cache->Get(packet.Questions.at(0).Name);
-
-                if (cacheValue.has_value()) {
-                    DNS::Package packetCached = cacheValue.value();
-                    packetCached.Header.ID = packet.Header.ID;
-                    m_Socket->send_to(NET::Buffer(DNS::CreateBufferFromPackage(packetCached)), point);
-
-                } else {
-                    NET::SocketUDP socket = {m_Service, NET::UDPoint(NET::UDP::v4(), 0)};
-                    socket.send_to(NET::Buffer(buffer), NET::UDPoint(NET::Address("5.3.3.3"), 53));
-                    size_t size = socket.receive(NET::Buffer(buffer));
-                    m_Socket->send_to(NET::Buffer(buffer, size), point);
-                    m_Cache->Add(packet.Questions[0].Name, DNS::CreatePackageFromBuffer(buffer));
+                            } else {
+                                auto answer = QueryUpstream(*Settings(), buffer);
+                                if (answer.empty())
+                                    return;
+                                socket->send_to(NET::Buffer(answer), point);
+                                m_Cache->Add(query, DNS::CreatePackageFromBuffer(answer));
+                            }
+                        } catch (std::exception const& error) {
+                            fmt::print("DNS Server: Dropped query: {} \n", error.what());
+                        }
+                    });
                 }
-            });
+            }));
         }
-    }));
-    m_Dispather.join();
+    }
+    m_Dispather->join();
 }
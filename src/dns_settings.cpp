@@ -0,0 +1,211 @@
+/*
+ * MIT License
+ *
+ * Copyright(c) 2021 Mikhail Gorobets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this softwareand associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright noticeand this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <dns/dns_settings.hpp>
+#include <dns/dns_affinity.hpp>
+#include <dns/dns_cache.hpp>
+#include <argparse/argparse.hpp>
+#include <fmt/format.h>
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <limits>
+
+//Timeouts are passed to poll() as int milliseconds, an hour is far more than any sane value
+constexpr uint32_t MAX_TIMEOUT = 3600 * 1000;
+
+struct Option {
+    const char* Name;
+    const char* Help;
+};
+
+//Long option names double as the keys of the configuration file
+constexpr Option OPTIONS[] = {
+    { "listen",           "comma separated listen addresses, \"::\" is IPv4/IPv6 dual-stack unless IPv4 addresses are listed (default: ::)" },
+    { "port",             "listen port (default: 57)" },
+    { "reactors",         "receiving threads per listen address (default: 1)" },
+    { "workers",          "threads processing queries (default: 2 x hardware threads, at least 4)" },
+    { "cpu-affinity",     "pin threads round-robin to the CPU list, e.g. 0-7,16-23 (default: none)" },
+    { "cache-size",       "maximum number of cached names, 0 is unlimited, else at least cache-shards (default: 0)" },
+    { "cache-shards",     "number of independently locked cache shards (default: 16)" },
+    { "hot-cache-size",   "hottest names replicated per thread, at most 256, 0 disables replicas (default: 0)" },
+    { "receive-timeout",  "interval of shutdown checks while no query arrives, in milliseconds, at most 3600000 (default: 200)" },
+    { "upstream-timeout", "upstream answer timeout in milliseconds, at most 3600000 (default: 2000)" },
+    { "sweep-interval",   "interval of expired TTL removal in seconds (default: 60)" },
+    { "upstreams",        "comma separated upstream servers, address[:port] or [IPv6]:port (default: 5.3.3.3:53)" },
+};
+
+static auto Split(std::string const& value, char delimiter) -> std::vector<std::string> {
+    std::vector<std::string> items;
+    size_t offset = 0;
+    while (offset <= value.size()) {
+        size_t end = value.find(delimiter, offset);
+        if (end == std::string::npos)
+            end = value.size();
+        if (end > offset)
+            items.push_back(value.substr(offset, end - offset));
+        offset = end + 1;
+    }
+    return items;
+}
+
+static auto Trim(std::string const& value) -> std::string {
+    size_t first = value.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return {};
+    size_t last = value.find_last_not_of(" \t\r");
+    return value.substr(first, last - first + 1);
+}
+
+template<typename T>
+static auto ParseNumber(std::string const& key, std::string const& value, T min, T max = std::numeric_limits<T>::max()) -> T {
+    T number = {};
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc{} || end != value.data() + value.size() || number < min || number > max)
+        throw std::invalid_argument(fmt::format("Invalid value of {}: {}", key, value));
+    return number;
+}
+
+static auto ParseEndpoint(std::string const& value) -> DNSSettings::Endpoint {
+    std::string address = value;
+    uint16_t port = 53;
+    if (value.starts_with('[')) {
+        size_t end = value.find(']');
+        if (end == std::string::npos)
+            throw std::invalid_argument("Invalid upstream: " + value);
+        address = value.substr(1, end - 1);
+        //"]" ends the value or is followed by the port
+        if (end + 1 < value.size()) {
+            if (value[end + 1] != ':')
+                throw std::invalid_argument("Invalid upstream: " + value);
+            port = ParseNumber<uint16_t>("upstreams", value.substr(end + 2), 1);
+        }
+    } else if (std::count(value.begin(), value.end(), ':') == 1) {
+        size_t colon = value.find(':');
+        address = value.substr(0, colon);
+        port = ParseNumber<uint16_t>("upstreams", value.substr(colon + 1), 1);
+    }
+    return DNSSettings::Endpoint(boost::asio::ip::make_address(address), port);
+}
+
+static auto ApplySetting(DNSSettings& settings, std::string const& key, std::string const& value) -> void {
+    if (key == "listen") {
+        settings.ListenAddresses.clear();
+        for (auto const& address : Split(value, ','))
+            settings.ListenAddresses.push_back(boost::asio::ip::make_address(Trim(address)));
+        if (settings.ListenAddresses.empty())
+            throw std::invalid_argument("No listen address");
+    } else if (key == "port") {
+        settings.Port = ParseNumber<uint16_t>(key, value, 1);
+    } else if (key == "reactors") {
+        settings.ReactorCount = ParseNumber<size_t>(key, value, 1);
+    } else if (key == "workers") {
+        settings.WorkerCount = ParseNumber<size_t>(key, value, 1);
+    } else if (key == "cpu-affinity") {
+        settings.Cpus = Affinity::ParseCpuList(value);
+    } else if (key == "cache-size") {
+        settings.CacheCapacity = ParseNumber<size_t>(key, value, 0);
+    } else if (key == "cache-shards") {
+        settings.CacheShards = ParseNumber<size_t>(key, value, 1);
+    } else if (key == "hot-cache-size") {
+        settings.HotCacheSize = ParseNumber<size_t>(key, value, 0, MAX_REPLICA_SIZE);
+    } else if (key == "receive-timeout") {
+        settings.ReceiveTimeout = ParseNumber<uint32_t>(key, value, 1, MAX_TIMEOUT);
+    } else if (key == "upstream-timeout") {
+        settings.UpstreamTimeout = ParseNumber<uint32_t>(key, value, 1, MAX_TIMEOUT);
+    } else if (key == "sweep-interval") {
+        settings.SweepInterval = ParseNumber<uint32_t>(key, value, 1);
+    } else if (key == "upstreams") {
+        settings.Upstreams.clear();
+        for (auto const& upstream : Split(value, ','))
+            settings.Upstreams.push_back(ParseEndpoint(Trim(upstream)));
+        if (settings.Upstreams.empty())
+            throw std::invalid_argument("No upstream server");
+    } else {
+        throw std::invalid_argument("Unknown setting: " + key);
+    }
+}
+
+//Every shard gets an equal part of the budget, a shard with none could never cache a name
+static auto CheckCacheCapacity(size_t capacity, size_t shardCount) -> void {
+    if (capacity != 0 && capacity < shardCount)
+        throw std::invalid_argument(fmt::format("cache-size {} is less than cache-shards {}", capacity, shardCount));
+}
+
+static auto ApplyConfigFile(DNSSettings& settings, std::string const& path) -> void {
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open config file: " + path);
+
+    //Lines are "key = value", "#" starts a comment
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); number++) {
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+        size_t separator = line.find('=');
+        if (separator == std::string::npos)
+            throw std::invalid_argument(fmt::format("{}:{}: Expected key = value", path, number));
+        ApplySetting(settings, Trim(line.substr(0, separator)), Trim(line.substr(separator + 1)));
+    }
+}
+
+auto LoadSettings(std::vector<std::string> const& arguments) -> DNSSettings {
+    argparse::ArgumentParser program("DNS");
+    program.add_argument("--config").help("configuration file with key = value lines, keys are the long option names");
+    for (auto const& option : OPTIONS)
+        program.add_argument(std::string("--") + option.Name).help(option.Help);
+    program.parse_args(arguments);
+
+    DNSSettings settings = {};
+    if (auto path = program.present<std::string>("--config"))
+        ApplyConfigFile(settings, path.value());
+
+    for (auto const& option : OPTIONS)
+        if (auto value = program.present<std::string>(std::string("--") + option.Name))
+            ApplySetting(settings, option.Name, value.value());
+
+    CheckCacheCapacity(settings.CacheCapacity, settings.CacheShards);
+    return settings;
+}
+
+auto ApplyReloadableSettings(DNSSettings& current, DNSSettings const& loaded) -> bool {
+    //The shard count of the running cache stays, so the new budget has to cover it
+    CheckCacheCapacity(loaded.CacheCapacity, current.CacheShards);
+
+    current.CacheCapacity = loaded.CacheCapacity;
+    current.ReceiveTimeout = loaded.ReceiveTimeout;
+    current.UpstreamTimeout = loaded.UpstreamTimeout;
+    current.SweepInterval = loaded.SweepInterval;
+    current.Upstreams = loaded.Upstreams;
+
+    return current.ListenAddresses == loaded.ListenAddresses
+        && current.Port == loaded.Port
+        && current.ReactorCount == loaded.ReactorCount
+        && current.WorkerCount == loaded.WorkerCount
+        && current.Cpus == loaded.Cpus
+        && current.CacheShards == loaded.CacheShards
+        && current.HotCacheSize == loaded.HotCacheSize;
+}